@@ -32,6 +32,13 @@ struct ConstExpr : public Expr {
     string toString(int parentPrec) const override;
 };
 
+// Binary operators in a fixed order, so they can index tables and be stored compactly.
+enum OpCode { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_LT, OP_GT, OP_LE, OP_GE, OP_AND, OP_OR, OP_COUNT };
+
+int opCode(const string &op);
+const char *opName(int code);
+int opPrecedence(int code);
+
 struct BinOpExpr : public Expr {
     shared_ptr<Expr> left, right;
     string op;
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ast.h"
+#include "parser.h"
+#include "interpreter.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Compact binary image of a parsed Function and its final states.
+//
+// Layout (host byte order, every section 4-byte aligned):
+//   BinHeader
+//   uint32_t stringOffsets[stringCount + 1]
+//   char     strings[stringBytes]          NUL-terminated, padded to 4
+//   BinExpr  exprs[exprCount]              post-order: children precede parents
+//   BinStmt  stmts[stmtCount]              each block is a contiguous run
+//   BinPair  pairs[pairCount]              parameters and memory entries
+//   uint32_t lists[listCount]              path condition expression indices
+//   BinState states[stateCount]
+//
+// The image is mmap'ed and read in place; BinImage never allocates per node.
+// Images are a local cache, not an interchange format: one written on a host
+// of the other byte order is rejected by the version check.
+
+const char BIN_MAGIC[4] = {'S', 'Y', 'M', 'X'};
+const uint32_t BIN_VERSION = 1;
+const uint32_t BIN_NONE = 0xffffffffu;
+
+enum BinExprKind : uint8_t { BIN_VAR, BIN_CONST, BIN_BINOP, BIN_NOT, BIN_NEG };
+enum BinStmtKind : uint8_t { BIN_ASSIGN, BIN_IF, BIN_RETURN };
+
+struct BinHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t stringCount, stringBytes;
+    uint32_t exprCount, stmtCount, pairCount, listCount, stateCount;
+    uint32_t funcName, funcRetType;
+    uint32_t paramBegin, paramCount;
+    uint32_t bodyBegin, bodyCount;
+    uint32_t retExpr;
+};
+
+// VAR/CONST: a = string index. BINOP: a, b = operands, op = OpCode.
+// NOT/NEG: a = operand.
+struct BinExpr {
+    uint8_t kind;
+    uint8_t op;
+    uint16_t reserved;
+    uint32_t a, b;
+};
+
+// ASSIGN: var, expr. IF: expr = condition plus both blocks. RETURN: expr.
+struct BinStmt {
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint32_t var;
+    uint32_t expr;
+    uint32_t thenBegin, thenCount;
+    uint32_t elseBegin, elseCount;
+};
+
+// Parameter: (type, name) strings. Memory entry: (name string, expr).
+struct BinPair {
+    uint32_t first, second;
+};
+
+struct BinState {
+    uint32_t memBegin, memCount;
+    uint32_t pcBegin, pcCount;
+    uint32_t result;
+};
+
+bool isBinaryImage(const string &path);
+bool writeBinary(const string &path, const Function &func, const vector<State> &states);
+
+struct BinImage {
+    BinImage();
+    ~BinImage();
+
+    bool open(const string &path, string &error);
+    void close();
+
+    const BinHeader &header() const { return *hdr; }
+    const char *data() const { return static_cast<const char *>(base); }
+    size_t bytes() const { return size; }
+    const char *str(uint32_t i) const { return strings + offsets[i]; }
+    const BinExpr &expr(uint32_t i) const { return exprs[i]; }
+    const BinStmt &stmt(uint32_t i) const { return stmts[i]; }
+    const BinPair &pair(uint32_t i) const { return pairs[i]; }
+    uint32_t list(uint32_t i) const { return lists[i]; }
+    const BinState &state(uint32_t i) const { return states[i]; }
+
+    // Same text as Expr::toString, rendered from the table without building nodes.
+    void printExpr(ostream &os, uint32_t i, int parentPrec = -1) const;
+
+    // Rebuild the in-memory AST; only needed by consumers that want Expr trees.
+    Function function() const;
+    vector<State> finalStates() const;
+
+private:
+    BinImage(const BinImage &);
+    BinImage &operator=(const BinImage &);
+
+    bool validate(string &error) const;
+    vector<shared_ptr<Expr>> materializeExprs() const;
+    vector<shared_ptr<Statement>> materializeBlock(uint32_t begin, uint32_t count,
+                                                   const vector<shared_ptr<Expr>> &nodes) const;
+
+    void *base;
+    size_t size;
+    const BinHeader *hdr;
+    const uint32_t *offsets;
+    const char *strings;
+    const BinExpr *exprs;
+    const BinStmt *stmts;
+    const BinPair *pairs;
+    const uint32_t *lists;
+    const BinState *states;
+};
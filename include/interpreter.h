@@ -12,7 +12,16 @@ struct State {
     shared_ptr<Expr> result;
 };
 
+// Parameter name -> literal value ("42", "-1", "true", "false").
+typedef map<string, string> Bindings;
+
 vector<State> symbolic_execution(const Function &func);
-vector<State> executeBlock(const vector<shared_ptr<Statement>> &stmts, const State &initialState);
-shared_ptr<Expr> eval_expr(shared_ptr<Expr> expr, const State &state);
+vector<State> executeBlock(const vector<shared_ptr<Statement>> &stmts, const State &initialState, bool fold = false);
+shared_ptr<Expr> eval_expr(shared_ptr<Expr> expr, const State &state, bool fold = false);
 
+// Bound parameters become constants and are folded during evaluation; only
+// branches whose condition is not constant fork and extend the path condition.
+// Also rewrites int values to canonical form ("+05" -> "5") so they fold.
+bool checkBindings(const Function &func, Bindings &inputs, string &error);
+vector<State> concolic_execution(const Function &func, const Bindings &inputs);
+vector<vector<State>> concolic_batch(const Function &func, const vector<Bindings> &rows, unsigned threads);
@@ -2,6 +2,16 @@
 
 #include "ast.h"
 #include <memory>
+#include <ostream>
 using namespace std;
 
 shared_ptr<Expr> simplify(shared_ptr<Expr> expr);
+
+// Rewrite only at the root; operands must already be simplified.
+shared_ptr<Expr> simplifyRoot(shared_ptr<Expr> expr);
+
+// Integer literal the rewrite rules can fold: whole string, within int range.
+bool parseInt(const string &s, long long &out);
+
+// One "<rule>\t<hits>" line per rewrite rule, in table order.
+void printRewriteStats(ostream &os);
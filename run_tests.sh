@@ -0,0 +1,98 @@
+#!/bin/sh
+# Runs every golden test in tests_in/ against tests_out/.
+# Usage: ./run_tests.sh [path/to/symbolic_executor]
+
+BIN=${1:-bin/symbolic_executor}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+pass() { echo "ok   $1"; }
+fail() { echo "FAIL $1"; FAILED=1; }
+
+# <input> <expected output>
+GOLDEN="
+base.txt base_out.txt
+brackets.txt brackets_out.txt
+division.txt division_out.txt
+in_bool.txt out_bool.txt
+in_bool_simple.txt out_bool_simple.txt
+logic.txt logic_out.txt
+max.txt max_out.txt
+simple_test.txt simple_test_out.txt
+simplify.txt simplify_out.txt
+"
+
+echo "$GOLDEN" | while read in out; do
+    [ -z "$in" ] && continue
+    if "$BIN" "tests_in/$in" "$TMP/$out" && cmp -s "$TMP/$out" "tests_out/$out"; then
+        pass "$in"
+    else
+        fail "$in"
+    fi
+    # Text -> binary image -> text must reproduce the golden output.
+    if "$BIN" --format=bin "tests_in/$in" "$TMP/$in.bin" &&
+       "$BIN" "$TMP/$in.bin" "$TMP/$out.rt" && cmp -s "$TMP/$out.rt" "tests_out/$out"; then
+        pass "$in (binary round trip)"
+    else
+        fail "$in (binary round trip)"
+    fi
+done | tee "$TMP/log"
+grep -q FAIL "$TMP/log" && FAILED=1
+
+# An image with another version must be rejected, not crash.
+"$BIN" --format=bin tests_in/max.txt "$TMP/v.bin"
+printf '\143' | dd of="$TMP/v.bin" bs=1 seek=4 conv=notrunc 2>/dev/null
+"$BIN" "$TMP/v.bin" "$TMP/v.out" 2>"$TMP/v.err"
+if [ $? -eq 1 ] && grep -q "unsupported version" "$TMP/v.err"; then
+    pass "binary version mismatch"
+else
+    fail "binary version mismatch"
+fi
+printf '\000\000\000\001' | dd of="$TMP/v.bin" bs=1 seek=4 conv=notrunc 2>/dev/null
+"$BIN" "$TMP/v.bin" "$TMP/v.out" 2>"$TMP/v.err"
+if [ $? -eq 1 ] && grep -q "byte order" "$TMP/v.err"; then
+    pass "binary byte order mismatch"
+else
+    fail "binary byte order mismatch"
+fi
+
+# Concolic rows: <program> <input rows>, expected in tests_out/<rows>_out.txt.
+for pair in max:max_inputs logic:logic_inputs; do
+    prog=${pair%%:*}; rows=${pair##*:}
+    if "$BIN" --inputs="tests_in/$rows.txt" "tests_in/$prog.txt" "$TMP/$rows.out" &&
+       cmp -s "$TMP/$rows.out" "tests_out/${rows}_out.txt"; then
+        pass "$rows.txt"
+    else
+        fail "$rows.txt"
+    fi
+done
+
+if ! "$BIN" --threads=-1 --bind=a=1 tests_in/max.txt "$TMP/t.out" 2>/dev/null &&
+   ! "$BIN" --threads=abc --bind=a=1 tests_in/max.txt "$TMP/t.out" 2>/dev/null; then
+    pass "invalid --threads rejected"
+else
+    fail "invalid --threads rejected"
+fi
+
+# Bound ints are range-checked and canonicalized so they always fold.
+if "$BIN" --bind=a=+5,b=03 tests_in/max.txt "$TMP/canon.out" &&
+   grep -q "result = 5" "$TMP/canon.out" && ! grep -q "+5" "$TMP/canon.out"; then
+    pass "canonical int binding"
+else
+    fail "canonical int binding"
+fi
+if ! "$BIN" --bind=a=99999999999 tests_in/max.txt "$TMP/range.out" 2>/dev/null; then
+    pass "out of range int binding"
+else
+    fail "out of range int binding"
+fi
+
+# Images record no bindings, so concolic runs cannot be cached as binary.
+if ! "$BIN" --format=bin --bind=a=1 tests_in/max.txt "$TMP/c.bin" 2>/dev/null; then
+    pass "binary output rejected in concolic mode"
+else
+    fail "binary output rejected in concolic mode"
+fi
+
+exit $FAILED
@@ -50,16 +50,35 @@ string ConstExpr::toString(int) const {
     return value;
 }
 
+static const char *const OP_NAMES[OP_COUNT] = {"+", "-", "*", "/", "<", ">", "<=", ">=", "&", "|"};
+
+int opCode(const string &op) {
+    for (int i = 0; i < OP_COUNT; i++)
+        if (op == OP_NAMES[i])
+            return i;
+    return -1;
+}
+
+const char *opName(int code) {
+    return code >= 0 && code < OP_COUNT ? OP_NAMES[code] : "?";
+}
+
 BinOpExpr::BinOpExpr(shared_ptr<Expr> l, const string &o, shared_ptr<Expr> r)
     : left(l), op(o), right(r) {}
-int BinOpExpr::precedence() const {
-    if(op == "*" || op == "/") return 3;
-    if(op == "+" || op == "-") return 2;
-    if(op == "<" || op == ">" || op == "<=" || op == ">=") return 1;
-    if(op == "&" || op == "|") return 0;
+int opPrecedence(int code) {
+    switch(code) {
+    case OP_MUL: case OP_DIV: return 3;
+    case OP_ADD: case OP_SUB: return 2;
+    case OP_LT: case OP_GT: case OP_LE: case OP_GE: return 1;
+    case OP_AND: case OP_OR: return 0;
+    }
     return -1;
 }
 
+int BinOpExpr::precedence() const {
+    return opPrecedence(opCode(op));
+}
+
 string BinOpExpr::toString(int parentPrec) const {
     int prec = precedence();
     string leftStr = left->toString(prec);
@@ -0,0 +1,453 @@
+#include "binformat.h"
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+static size_t align4(size_t n) { return (n + 3) & ~size_t(3); }
+
+static uint32_t byteSwap(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+struct BinWriter {
+    vector<uint32_t> offsets;
+    string strings;
+    map<string, uint32_t> stringIndex;
+    vector<BinExpr> exprs;
+    map<const Expr *, uint32_t> exprIndex;
+    map<tuple<uint8_t, uint8_t, uint32_t, uint32_t>, uint32_t> nodeIndex;
+    vector<BinStmt> stmts;
+    vector<BinPair> pairs;
+    vector<uint32_t> lists;
+    vector<BinState> states;
+
+    uint32_t addString(const string &s) {
+        auto it = stringIndex.find(s);
+        if (it != stringIndex.end())
+            return it->second;
+        uint32_t idx = offsets.size();
+        offsets.push_back(strings.size());
+        strings += s;
+        strings += '\0';
+        stringIndex[s] = idx;
+        return idx;
+    }
+
+    // Structurally equal subtrees (common after symbolic execution) are stored once.
+    uint32_t addExpr(const shared_ptr<Expr> &expr) {
+        if (!expr)
+            return BIN_NONE;
+        auto it = exprIndex.find(expr.get());
+        if (it != exprIndex.end())
+            return it->second;
+        BinExpr node = BinExpr();
+        if (auto var = dynamic_pointer_cast<VarExpr>(expr)) {
+            node.kind = BIN_VAR;
+            node.a = addString(var->name);
+        } else if (auto c = dynamic_pointer_cast<ConstExpr>(expr)) {
+            node.kind = BIN_CONST;
+            node.a = addString(c->value);
+        } else if (auto bin = dynamic_pointer_cast<BinOpExpr>(expr)) {
+            node.kind = BIN_BINOP;
+            node.op = opCode(bin->op);
+            node.a = addExpr(bin->left);
+            node.b = addExpr(bin->right);
+        } else if (auto notE = dynamic_pointer_cast<NotExpr>(expr)) {
+            node.kind = BIN_NOT;
+            node.a = addExpr(notE->expr);
+        } else if (auto negE = dynamic_pointer_cast<NegExpr>(expr)) {
+            node.kind = BIN_NEG;
+            node.a = addExpr(negE->expr);
+        }
+        auto key = make_tuple(node.kind, node.op, node.a, node.b);
+        auto found = nodeIndex.find(key);
+        uint32_t idx;
+        if (found != nodeIndex.end()) {
+            idx = found->second;
+        } else {
+            idx = exprs.size();
+            exprs.push_back(node);
+            nodeIndex[key] = idx;
+        }
+        exprIndex[expr.get()] = idx;
+        return idx;
+    }
+
+    // Reserves a contiguous run for the block; nested blocks follow it.
+    void addBlock(const vector<shared_ptr<Statement>> &block, uint32_t &begin, uint32_t &count) {
+        begin = stmts.size();
+        count = block.size();
+        stmts.resize(stmts.size() + block.size());
+        for (size_t i = 0; i < block.size(); i++) {
+            BinStmt s = BinStmt();
+            s.var = s.expr = BIN_NONE;
+            if (auto assign = dynamic_pointer_cast<AssignStmt>(block[i])) {
+                s.kind = BIN_ASSIGN;
+                s.var = addString(assign->var);
+                s.expr = addExpr(assign->expr);
+            } else if (auto ifStmt = dynamic_pointer_cast<IfStmt>(block[i])) {
+                s.kind = BIN_IF;
+                s.expr = addExpr(ifStmt->cond);
+                addBlock(ifStmt->thenStmts, s.thenBegin, s.thenCount);
+                addBlock(ifStmt->elseStmts, s.elseBegin, s.elseCount);
+            } else if (auto retStmt = dynamic_pointer_cast<ReturnStmt>(block[i])) {
+                s.kind = BIN_RETURN;
+                s.expr = addExpr(retStmt->expr);
+            }
+            stmts[begin + i] = s;
+        }
+    }
+};
+
+template <typename T>
+static void writeSection(ofstream &ofs, const vector<T> &v) {
+    if (!v.empty())
+        ofs.write(reinterpret_cast<const char *>(&v[0]), v.size() * sizeof(T));
+}
+
+bool writeBinary(const string &path, const Function &func, const vector<State> &finalStates) {
+    BinWriter w;
+    BinHeader hdr = BinHeader();
+    memcpy(hdr.magic, BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = BIN_VERSION;
+    hdr.funcName = w.addString(func.name);
+    hdr.funcRetType = w.addString(func.retType);
+    hdr.paramBegin = w.pairs.size();
+    hdr.paramCount = func.parameters.size();
+    for (auto &param : func.parameters) {
+        BinPair p = {w.addString(param.first), w.addString(param.second)};
+        w.pairs.push_back(p);
+    }
+    w.addBlock(func.statements, hdr.bodyBegin, hdr.bodyCount);
+    hdr.retExpr = w.addExpr(func.retExpr);
+
+    for (auto &st : finalStates) {
+        BinState s;
+        s.memBegin = w.pairs.size();
+        s.memCount = st.memory.size();
+        for (auto &m : st.memory) {
+            BinPair p = {w.addString(m.first), w.addExpr(m.second)};
+            w.pairs.push_back(p);
+        }
+        s.pcBegin = w.lists.size();
+        s.pcCount = st.pathCondition.size();
+        for (auto &c : st.pathCondition)
+            w.lists.push_back(w.addExpr(c));
+        s.result = w.addExpr(st.result);
+        w.states.push_back(s);
+    }
+
+    hdr.stringCount = w.offsets.size();
+    w.offsets.push_back(w.strings.size());
+    w.strings.resize(align4(w.strings.size()), '\0');
+    hdr.stringBytes = w.strings.size();
+    hdr.exprCount = w.exprs.size();
+    hdr.stmtCount = w.stmts.size();
+    hdr.pairCount = w.pairs.size();
+    hdr.listCount = w.lists.size();
+    hdr.stateCount = w.states.size();
+
+    ofstream ofs(path, ios::binary);
+    if (!ofs)
+        return false;
+    ofs.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    writeSection(ofs, w.offsets);
+    ofs.write(w.strings.data(), w.strings.size());
+    writeSection(ofs, w.exprs);
+    writeSection(ofs, w.stmts);
+    writeSection(ofs, w.pairs);
+    writeSection(ofs, w.lists);
+    writeSection(ofs, w.states);
+    return bool(ofs);
+}
+
+bool isBinaryImage(const string &path) {
+    ifstream ifs(path, ios::binary);
+    char magic[4];
+    return ifs.read(magic, sizeof(magic)) && memcmp(magic, BIN_MAGIC, sizeof(magic)) == 0;
+}
+
+BinImage::BinImage()
+    : base(nullptr), size(0), hdr(nullptr), offsets(nullptr), strings(nullptr),
+      exprs(nullptr), stmts(nullptr), pairs(nullptr), lists(nullptr), states(nullptr) {}
+
+BinImage::~BinImage() { close(); }
+
+void BinImage::close() {
+    if (base)
+        munmap(base, size);
+    base = nullptr;
+    size = 0;
+    hdr = nullptr;
+    offsets = nullptr;
+    strings = nullptr;
+    exprs = nullptr;
+    stmts = nullptr;
+    pairs = nullptr;
+    lists = nullptr;
+    states = nullptr;
+}
+
+bool BinImage::open(const string &path, string &error) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || size_t(sb.st_size) < sizeof(BinHeader)) {
+        ::close(fd);
+        error = "truncated image";
+        return false;
+    }
+    size = sb.st_size;
+    base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        error = "mmap failed";
+        return false;
+    }
+
+    const char *p = static_cast<const char *>(base);
+    hdr = reinterpret_cast<const BinHeader *>(p);
+    if (memcmp(hdr->magic, BIN_MAGIC, sizeof(hdr->magic)) != 0) {
+        error = "bad magic";
+        close();
+        return false;
+    }
+    uint32_t version = hdr->version;
+    if (version != BIN_VERSION) {
+        if (version == byteSwap(BIN_VERSION))
+            error = "image was written with a different byte order";
+        else
+            error = "unsupported version " + to_string(version);
+        close();
+        return false;
+    }
+
+    uint64_t need = sizeof(BinHeader)
+        + uint64_t(hdr->stringCount + 1ull) * sizeof(uint32_t)
+        + hdr->stringBytes
+        + uint64_t(hdr->exprCount) * sizeof(BinExpr)
+        + uint64_t(hdr->stmtCount) * sizeof(BinStmt)
+        + uint64_t(hdr->pairCount) * sizeof(BinPair)
+        + uint64_t(hdr->listCount) * sizeof(uint32_t)
+        + uint64_t(hdr->stateCount) * sizeof(BinState);
+    if (need != size || hdr->stringBytes % 4 != 0) {
+        close();
+        error = "section sizes do not match file size";
+        return false;
+    }
+
+    p += sizeof(BinHeader);
+    offsets = reinterpret_cast<const uint32_t *>(p);
+    p += (hdr->stringCount + 1) * sizeof(uint32_t);
+    strings = p;
+    p += hdr->stringBytes;
+    exprs = reinterpret_cast<const BinExpr *>(p);
+    p += hdr->exprCount * sizeof(BinExpr);
+    stmts = reinterpret_cast<const BinStmt *>(p);
+    p += hdr->stmtCount * sizeof(BinStmt);
+    pairs = reinterpret_cast<const BinPair *>(p);
+    p += hdr->pairCount * sizeof(BinPair);
+    lists = reinterpret_cast<const uint32_t *>(p);
+    p += hdr->listCount * sizeof(uint32_t);
+    states = reinterpret_cast<const BinState *>(p);
+
+    if (!validate(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+static bool inRange(uint32_t begin, uint32_t count, uint32_t total) {
+    return begin <= total && count <= total - begin;
+}
+
+// One linear pass over the tables so accessors can index without checks.
+bool BinImage::validate(string &error) const {
+    const BinHeader &h = *hdr;
+    if (offsets[h.stringCount] > h.stringBytes) {
+        error = "string table overflow";
+        return false;
+    }
+    for (uint32_t i = 0; i < h.stringCount; i++) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] == 0 || offsets[i + 1] > h.stringBytes ||
+            strings[offsets[i + 1] - 1] != '\0') {
+            error = "malformed string " + to_string(i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.exprCount; i++) {
+        const BinExpr &e = exprs[i];
+        bool ok;
+        switch (e.kind) {
+        case BIN_VAR:
+        case BIN_CONST: ok = e.a < h.stringCount; break;
+        case BIN_BINOP: ok = e.a < i && e.b < i && e.op < OP_COUNT; break;
+        case BIN_NOT:
+        case BIN_NEG: ok = e.a < i; break;
+        default: ok = false;
+        }
+        if (!ok) {
+            error = "malformed expression " + to_string(i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.stmtCount; i++) {
+        const BinStmt &s = stmts[i];
+        bool ok = s.expr < h.exprCount;
+        if (s.kind == BIN_ASSIGN)
+            ok = ok && s.var < h.stringCount;
+        else if (s.kind == BIN_IF)
+            ok = ok && s.thenBegin > i && inRange(s.thenBegin, s.thenCount, h.stmtCount)
+                    && s.elseBegin > i && inRange(s.elseBegin, s.elseCount, h.stmtCount);
+        else if (s.kind != BIN_RETURN)
+            ok = false;
+        if (!ok) {
+            error = "malformed statement " + to_string(i);
+            return false;
+        }
+    }
+    if (h.funcName >= h.stringCount || h.funcRetType >= h.stringCount ||
+        !inRange(h.paramBegin, h.paramCount, h.pairCount) ||
+        !inRange(h.bodyBegin, h.bodyCount, h.stmtCount) ||
+        (h.retExpr != BIN_NONE && h.retExpr >= h.exprCount)) {
+        error = "malformed function header";
+        return false;
+    }
+    for (uint32_t i = 0; i < h.paramCount; i++) {
+        const BinPair &p = pairs[h.paramBegin + i];
+        if (p.first >= h.stringCount || p.second >= h.stringCount) {
+            error = "malformed parameter " + to_string(i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.listCount; i++) {
+        if (lists[i] >= h.exprCount) {
+            error = "malformed path condition entry " + to_string(i);
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < h.stateCount; i++) {
+        const BinState &s = states[i];
+        bool ok = inRange(s.memBegin, s.memCount, h.pairCount) &&
+                  inRange(s.pcBegin, s.pcCount, h.listCount) &&
+                  (s.result == BIN_NONE || s.result < h.exprCount);
+        for (uint32_t j = 0; ok && j < s.memCount; j++) {
+            const BinPair &p = pairs[s.memBegin + j];
+            ok = p.first < h.stringCount && p.second < h.exprCount;
+        }
+        if (!ok) {
+            error = "malformed state " + to_string(i);
+            return false;
+        }
+    }
+    return true;
+}
+
+void BinImage::printExpr(ostream &os, uint32_t i, int parentPrec) const {
+    const BinExpr &e = exprs[i];
+    switch (e.kind) {
+    case BIN_VAR:
+        os << "'" << str(e.a) << "'";
+        return;
+    case BIN_CONST:
+        os << str(e.a);
+        return;
+    case BIN_BINOP: {
+        int prec = opPrecedence(e.op);
+        if (prec < parentPrec)
+            os << "(";
+        printExpr(os, e.a, prec);
+        os << " " << opName(e.op) << " ";
+        printExpr(os, e.b, prec + 1);
+        if (prec < parentPrec)
+            os << ")";
+        return;
+    }
+    default: {
+        // NOT and NEG share NotExpr/NegExpr precedence 4.
+        if (4 < parentPrec)
+            os << "(";
+        os << (e.kind == BIN_NOT ? "!" : "-");
+        printExpr(os, e.a, 4);
+        if (4 < parentPrec)
+            os << ")";
+    }
+    }
+}
+
+// Children precede parents, so a single forward pass rebuilds every node.
+vector<shared_ptr<Expr>> BinImage::materializeExprs() const {
+    vector<shared_ptr<Expr>> nodes(hdr->exprCount);
+    for (uint32_t i = 0; i < hdr->exprCount; i++) {
+        const BinExpr &e = exprs[i];
+        switch (e.kind) {
+        case BIN_VAR: nodes[i] = make_shared<VarExpr>(str(e.a)); break;
+        case BIN_CONST: nodes[i] = make_shared<ConstExpr>(str(e.a)); break;
+        case BIN_BINOP: nodes[i] = make_shared<BinOpExpr>(nodes[e.a], opName(e.op), nodes[e.b]); break;
+        case BIN_NOT: nodes[i] = make_shared<NotExpr>(nodes[e.a]); break;
+        case BIN_NEG: nodes[i] = make_shared<NegExpr>(nodes[e.a]); break;
+        }
+    }
+    return nodes;
+}
+
+vector<shared_ptr<Statement>> BinImage::materializeBlock(uint32_t begin, uint32_t count,
+                                                         const vector<shared_ptr<Expr>> &nodes) const {
+    vector<shared_ptr<Statement>> block;
+    for (uint32_t i = begin; i < begin + count; i++) {
+        const BinStmt &s = stmts[i];
+        if (s.kind == BIN_ASSIGN)
+            block.push_back(make_shared<AssignStmt>(str(s.var), nodes[s.expr]));
+        else if (s.kind == BIN_IF)
+            block.push_back(make_shared<IfStmt>(nodes[s.expr],
+                                                materializeBlock(s.thenBegin, s.thenCount, nodes),
+                                                materializeBlock(s.elseBegin, s.elseCount, nodes)));
+        else
+            block.push_back(make_shared<ReturnStmt>(nodes[s.expr]));
+    }
+    return block;
+}
+
+Function BinImage::function() const {
+    vector<shared_ptr<Expr>> nodes = materializeExprs();
+    Function func;
+    func.name = str(hdr->funcName);
+    func.retType = str(hdr->funcRetType);
+    for (uint32_t i = 0; i < hdr->paramCount; i++) {
+        const BinPair &p = pairs[hdr->paramBegin + i];
+        func.parameters.push_back({str(p.first), str(p.second)});
+    }
+    func.statements = materializeBlock(hdr->bodyBegin, hdr->bodyCount, nodes);
+    if (hdr->retExpr != BIN_NONE)
+        func.retExpr = nodes[hdr->retExpr];
+    return func;
+}
+
+vector<State> BinImage::finalStates() const {
+    vector<shared_ptr<Expr>> nodes = materializeExprs();
+    vector<State> result(hdr->stateCount);
+    for (uint32_t i = 0; i < hdr->stateCount; i++) {
+        const BinState &s = states[i];
+        for (uint32_t j = 0; j < s.memCount; j++) {
+            const BinPair &p = pairs[s.memBegin + j];
+            result[i].memory[str(p.first)] = nodes[p.second];
+        }
+        for (uint32_t j = 0; j < s.pcCount; j++)
+            result[i].pathCondition.push_back(nodes[lists[s.pcBegin + j]]);
+        if (s.result != BIN_NONE)
+            result[i].result = nodes[s.result];
+    }
+    return result;
+}
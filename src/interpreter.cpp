@@ -1,11 +1,67 @@
 #include "interpreter.h"
 #include "parser.h"
 #include "ast.h"
+#include "simplify.h"
 #include <iostream>
 #include <cstdlib>
+#include <thread>
 using namespace std;
 
-shared_ptr<Expr> eval_expr(shared_ptr<Expr> expr, const State &state) {
+// Truth value of a literal: 1 true, 0 false, -1 not a bool or int literal.
+static int literalTruth(const string &value) {
+    if (value == "true")
+        return 1;
+    if (value == "false")
+        return 0;
+    long long v;
+    if (!parseInt(value, v))
+        return -1;
+    return v != 0 ? 1 : 0;
+}
+
+// Folds an operator over two literals; null when the result is not a literal
+// (unknown operand kinds or division by zero).
+static shared_ptr<Expr> foldBinary(int op, const string &l, const string &r) {
+    if (op == OP_AND || op == OP_OR) {
+        int a = literalTruth(l), b = literalTruth(r);
+        if (a < 0 || b < 0)
+            return nullptr;
+        bool res = op == OP_AND ? (a && b) : (a || b);
+        return make_shared<ConstExpr>(res ? "true" : "false");
+    }
+    long long a, b, res;
+    if (!parseInt(l, a) || !parseInt(r, b))
+        return nullptr;
+    switch (op) {
+    case OP_ADD: res = a + b; break;
+    case OP_SUB: res = a - b; break;
+    case OP_MUL: res = a * b; break;
+    case OP_DIV:
+        if (b == 0)
+            return nullptr;
+        res = a / b;
+        break;
+    case OP_LT: res = (a < b) ? 1 : 0; break;
+    case OP_GT: res = (a > b) ? 1 : 0; break;
+    case OP_LE: res = (a <= b) ? 1 : 0; break;
+    case OP_GE: res = (a >= b) ? 1 : 0; break;
+    default: return nullptr;
+    }
+    return make_shared<ConstExpr>(to_string(static_cast<int>(res)));
+}
+
+static shared_ptr<Expr> asBool(const shared_ptr<Expr> &e, const shared_ptr<ConstExpr> &c) {
+    if (!c)
+        return e;
+    int truth = literalTruth(c->value);
+    if (truth < 0)
+        return e;
+    return make_shared<ConstExpr>(truth ? "true" : "false");
+}
+
+// With fold set, literal operands are combined directly; a node is only
+// built (and handed to simplifyRoot) when an operand is still symbolic.
+shared_ptr<Expr> eval_expr(shared_ptr<Expr> expr, const State &state, bool fold) {
     if (auto var = dynamic_pointer_cast<VarExpr>(expr)) {
         auto it = state.memory.find(var->name);
         if (it != state.memory.end())
@@ -14,49 +70,91 @@ shared_ptr<Expr> eval_expr(shared_ptr<Expr> expr, const State &state) {
     } else if (dynamic_pointer_cast<ConstExpr>(expr)) {
         return expr;
     } else if (auto bin = dynamic_pointer_cast<BinOpExpr>(expr)) {
-        auto left = eval_expr(bin->left, state);
-        auto right = eval_expr(bin->right, state);
-        return make_shared<BinOpExpr>(left, bin->op, right);
+        auto left = eval_expr(bin->left, state, fold);
+        auto right = eval_expr(bin->right, state, fold);
+        if (!fold)
+            return make_shared<BinOpExpr>(left, bin->op, right);
+        auto lc = dynamic_pointer_cast<ConstExpr>(left);
+        auto rc = dynamic_pointer_cast<ConstExpr>(right);
+        int op = opCode(bin->op);
+        if (lc && rc) {
+            if (auto folded = foldBinary(op, lc->value, rc->value))
+                return folded;
+        }
+        if (op == OP_AND || op == OP_OR) {
+            // A folded comparison is 1/0; spell it as a bool so the logic identities apply.
+            left = asBool(left, lc);
+            right = asBool(right, rc);
+        }
+        return simplifyRoot(make_shared<BinOpExpr>(left, bin->op, right));
     } else if (auto notE = dynamic_pointer_cast<NotExpr>(expr)) {
-        auto inner = eval_expr(notE->expr, state);
-        return make_shared<NotExpr>(inner);
+        auto inner = eval_expr(notE->expr, state, fold);
+        if (!fold)
+            return make_shared<NotExpr>(inner);
+        if (auto c = dynamic_pointer_cast<ConstExpr>(inner)) {
+            int truth = literalTruth(c->value);
+            if (truth >= 0)
+                return make_shared<ConstExpr>(truth ? "false" : "true");
+        }
+        return simplifyRoot(make_shared<NotExpr>(inner));
     } else if (auto negE = dynamic_pointer_cast<NegExpr>(expr)) {
-        auto inner = eval_expr(negE->expr, state);
-        return make_shared<NegExpr>(inner);
+        auto inner = eval_expr(negE->expr, state, fold);
+        if (!fold)
+            return make_shared<NegExpr>(inner);
+        long long v;
+        if (auto c = dynamic_pointer_cast<ConstExpr>(inner)) {
+            if (parseInt(c->value, v))
+                return make_shared<ConstExpr>(to_string(-v));
+        }
+        return simplifyRoot(make_shared<NegExpr>(inner));
     }
     return expr;
 }
 
-vector<State> executeStatement(shared_ptr<Statement> stmt, const State &state) {
+// Truth value of a folded condition: 1 taken, 0 not taken, -1 still symbolic.
+static int constTruth(const shared_ptr<Expr> &cond) {
+    auto c = dynamic_pointer_cast<ConstExpr>(cond);
+    return c ? literalTruth(c->value) : -1;
+}
+
+vector<State> executeStatement(shared_ptr<Statement> stmt, const State &state, bool fold) {
     vector<State> states;
     if (auto assign = dynamic_pointer_cast<AssignStmt>(stmt)) {
         State newState = state;
-        newState.memory[assign->var] = eval_expr(assign->expr, state);
+        newState.memory[assign->var] = eval_expr(assign->expr, state, fold);
         states.push_back(newState);
     } else if (auto ifStmt = dynamic_pointer_cast<IfStmt>(stmt)) {
+        auto cond = eval_expr(ifStmt->cond, state, fold);
+        if (fold) {
+            int taken = constTruth(cond);
+            if (taken == 1)
+                return executeBlock(ifStmt->thenStmts, state, fold);
+            if (taken == 0)
+                return executeBlock(ifStmt->elseStmts, state, fold);
+        }
         State thenState = state;
-        thenState.pathCondition.push_back(eval_expr(ifStmt->cond, state));
-        vector<State> thenStates = executeBlock(ifStmt->thenStmts, thenState);
+        thenState.pathCondition.push_back(cond);
+        vector<State> thenStates = executeBlock(ifStmt->thenStmts, thenState, fold);
         State elseState = state;
-        elseState.pathCondition.push_back(make_shared<NotExpr>(eval_expr(ifStmt->cond, state)));
-        vector<State> elseStates = executeBlock(ifStmt->elseStmts, elseState);
+        elseState.pathCondition.push_back(make_shared<NotExpr>(cond));
+        vector<State> elseStates = executeBlock(ifStmt->elseStmts, elseState, fold);
         states.insert(states.end(), thenStates.begin(), thenStates.end());
         states.insert(states.end(), elseStates.begin(), elseStates.end());
     } else if (auto retStmt = dynamic_pointer_cast<ReturnStmt>(stmt)) {
         State newState = state;
-        newState.result = eval_expr(retStmt->expr, state);
+        newState.result = eval_expr(retStmt->expr, state, fold);
         states.push_back(newState);
     }
     return states;
 }
 
-vector<State> executeBlock(const vector<shared_ptr<Statement>> &stmts, const State &initialState) {
+vector<State> executeBlock(const vector<shared_ptr<Statement>> &stmts, const State &initialState, bool fold) {
     vector<State> states;
     states.push_back(initialState);
     for (auto stmt : stmts) {
         vector<State> newStates;
         for (auto st : states) {
-            vector<State> stmtStates = executeStatement(stmt, st);
+            vector<State> stmtStates = executeStatement(stmt, st, fold);
             newStates.insert(newStates.end(), stmtStates.begin(), stmtStates.end());
         }
         states = newStates;
@@ -75,3 +173,72 @@ vector<State> symbolic_execution(const Function &func) {
     }
     return states;
 }
+
+bool checkBindings(const Function &func, Bindings &inputs, string &error) {
+    for (auto &in : inputs) {
+        const string *type = nullptr;
+        for (auto &param : func.parameters)
+            if (param.second == in.first)
+                type = &param.first;
+        if (!type) {
+            error = "unknown parameter " + in.first;
+            return false;
+        }
+        bool ok;
+        if (*type == "bool") {
+            ok = in.second == "true" || in.second == "false";
+        } else {
+            long long v;
+            ok = parseInt(in.second, v);
+            if (ok)
+                in.second = to_string(v);
+        }
+        if (!ok) {
+            error = "bad " + *type + " value for " + in.first + ": " + in.second;
+            return false;
+        }
+    }
+    return true;
+}
+
+vector<State> concolic_execution(const Function &func, const Bindings &inputs) {
+    State initState;
+    for (auto &param : func.parameters) {
+        auto it = inputs.find(param.second);
+        if (it != inputs.end())
+            initState.memory[param.second] = make_shared<ConstExpr>(it->second);
+        else
+            initState.memory[param.second] = make_shared<VarExpr>(param.second);
+    }
+    vector<State> states = executeBlock(func.statements, initState, true);
+    for (auto &st : states) {
+        st.result = eval_expr(func.retExpr, st, true);
+    }
+    return states;
+}
+
+// Rows are split into contiguous slices, one per worker; results keep row order.
+vector<vector<State>> concolic_batch(const Function &func, const vector<Bindings> &rows, unsigned threads) {
+    vector<vector<State>> results(rows.size());
+    if (threads == 0)
+        threads = 1;
+    if (threads > rows.size())
+        threads = rows.size();
+    if (threads <= 1) {
+        for (size_t i = 0; i < rows.size(); i++)
+            results[i] = concolic_execution(func, rows[i]);
+        return results;
+    }
+    vector<thread> workers;
+    size_t chunk = (rows.size() + threads - 1) / threads;
+    for (size_t begin = 0; begin < rows.size(); begin += chunk) {
+        size_t end = min(rows.size(), begin + chunk);
+        workers.push_back(thread([&func, &rows, &results, begin, end] {
+            for (size_t i = begin; i < end; i++)
+                results[i] = concolic_execution(func, rows[i]);
+        }));
+    }
+    for (auto &w : workers)
+        w.join();
+    return results;
+}
@@ -2,57 +2,264 @@
 #include "interpreter.h"
 #include "simplify.h"
 #include "ast.h"
+#include "binformat.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <thread>
 using namespace std;
 
-int main(int argc, char* argv[]) {
-    if(argc != 3) {
-        cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << endl;
-        return 1;
-    }
-    string inputFile = argv[1];
-    string outputFile = argv[2];
-    ifstream ifs(inputFile);
-    if(!ifs) {
-        cerr << "Failed to open input file " << inputFile << endl;
-        return 1;
-    }
-    stringstream buffer;
-    buffer << ifs.rdbuf();
-    string programText = buffer.str();
-    vector<Token> tokens = tokenize(programText);
-    Parser parser(tokens);
-    Function func = parser.parseFunction();
-    vector<State> finalStates = symbolic_execution(func);
-    
-    ofstream ofs(outputFile);
-    if(!ofs) {
-        cerr << "Failed to open output file " << outputFile << endl;
-        return 1;
+// Simplification is applied once here so the text and binary outputs agree.
+static vector<State> simplifyStates(const vector<State> &states) {
+    vector<State> out = states;
+    for(auto &st : out) {
+        for(auto &p : st.memory)
+            p.second = simplify(p.second);
+        for(auto &c : st.pathCondition)
+            c = simplify(c);
+        if(st.result)
+            st.result = simplify(st.result);
     }
+    return out;
+}
+
+static void writeText(ostream &ofs, const vector<State> &finalStates) {
     ofs << "{\n";
     for(const auto &st : finalStates) {
         ofs << "\t{\n";
         for(auto &p : st.memory) {
-            ofs << "\t\t" << p.first << " = " << simplify(p.second)->toString() << "\n";
+            ofs << "\t\t" << p.first << " = " << p.second->toString() << "\n";
         }
         ofs << "\t\tpc = ";
         if(st.pathCondition.empty())
             ofs << "true";
         else {
             for(size_t i = 0; i < st.pathCondition.size(); i++) {
-                ofs << simplify(st.pathCondition[i])->toString();
+                ofs << st.pathCondition[i]->toString();
                 if(i + 1 < st.pathCondition.size())
                     ofs << " & ";
             }
         }
         ofs << "\n";
-        ofs << "\t\tresult = " << (st.result ? simplify(st.result)->toString() : "undefined") << "\n";
+        ofs << "\t\tresult = " << (st.result ? st.result->toString() : "undefined") << "\n";
+        ofs << "\t}\n";
+    }
+    ofs << "}\n";
+}
+
+// Same layout as writeText, printed straight from a mapped image.
+static void writeImageText(ostream &ofs, const BinImage &image) {
+    ofs << "{\n";
+    for(uint32_t s = 0; s < image.header().stateCount; s++) {
+        const BinState &st = image.state(s);
+        ofs << "\t{\n";
+        for(uint32_t i = 0; i < st.memCount; i++) {
+            const BinPair &p = image.pair(st.memBegin + i);
+            ofs << "\t\t" << image.str(p.first) << " = ";
+            image.printExpr(ofs, p.second);
+            ofs << "\n";
+        }
+        ofs << "\t\tpc = ";
+        if(st.pcCount == 0)
+            ofs << "true";
+        else {
+            for(uint32_t i = 0; i < st.pcCount; i++) {
+                image.printExpr(ofs, image.list(st.pcBegin + i));
+                if(i + 1 < st.pcCount)
+                    ofs << " & ";
+            }
+        }
+        ofs << "\n";
+        ofs << "\t\tresult = ";
+        if(st.result == BIN_NONE)
+            ofs << "undefined";
+        else
+            image.printExpr(ofs, st.result);
+        ofs << "\n";
         ofs << "\t}\n";
     }
     ofs << "}\n";
+}
+
+// "a=1,b=true" or "a=1 b=true"; later entries win.
+static bool parseBindings(const string &text, Bindings &out, string &error) {
+    string item;
+    stringstream ss(text);
+    while(ss >> item) {
+        stringstream parts(item);
+        string pair;
+        while(getline(parts, pair, ',')) {
+            if(pair.empty())
+                continue;
+            size_t eq = pair.find('=');
+            if(eq == string::npos || eq == 0) {
+                error = "expected name=value, got " + pair;
+                return false;
+            }
+            out[pair.substr(0, eq)] = pair.substr(eq + 1);
+        }
+    }
+    return true;
+}
+
+// One row per line; blank lines and lines starting with '#' are skipped.
+static bool readInputRows(const string &path, const Bindings &defaults,
+                          vector<Bindings> &rows, vector<string> &labels, string &error) {
+    ifstream ifs(path);
+    if(!ifs) {
+        error = "failed to open inputs file " + path;
+        return false;
+    }
+    string line;
+    size_t lineNo = 0;
+    while(getline(ifs, line)) {
+        lineNo++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if(start == string::npos || line[start] == '#')
+            continue;
+        Bindings row = defaults;
+        if(!parseBindings(line, row, error)) {
+            error = path + ":" + to_string(lineNo) + ": " + error;
+            return false;
+        }
+        rows.push_back(row);
+        labels.push_back(line.substr(start, line.find_last_not_of(" \t\r") + 1 - start));
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    string format = "text";
+    bool rewriteStats = false;
+    bool concolic = false;
+    string bindText, inputsFile;
+    unsigned threads = thread::hardware_concurrency();
+    bool badThreads = false;
+    vector<string> args;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg.compare(0, 9, "--format=") == 0)
+            format = arg.substr(9);
+        else if(arg == "--rewrite-stats")
+            rewriteStats = true;
+        else if(arg.compare(0, 7, "--bind=") == 0) {
+            bindText += " " + arg.substr(7);
+            concolic = true;
+        } else if(arg.compare(0, 9, "--inputs=") == 0) {
+            inputsFile = arg.substr(9);
+            concolic = true;
+        } else if(arg.compare(0, 10, "--threads=") == 0) {
+            long long n;
+            badThreads = !parseInt(arg.substr(10), n) || n <= 0;
+            threads = badThreads ? 0 : n;
+        } else
+            args.push_back(arg);
+    }
+    if(args.size() != 2 || (format != "text" && format != "bin") || badThreads) {
+        cerr << "Usage: " << argv[0] << " [--format=bin|text] [--rewrite-stats]"
+             << " [--bind=name=value,...] [--inputs=rows_file] [--threads=N]"
+             << " <input_file> <output_file>" << endl;
+        return 1;
+    }
+    if(format == "bin" && concolic) {
+        // An image records no bindings, so a concolic run would read back as a full symbolic one.
+        cerr << "Binary output is not supported with --bind or --inputs" << endl;
+        return 1;
+    }
+    string inputFile = args[0];
+    string outputFile = args[1];
+
+    Function func;
+    vector<State> finalStates;
+    vector<vector<State>> rowStates;
+    vector<string> rowLabels;
+    if(isBinaryImage(inputFile)) {
+        BinImage image;
+        string error;
+        if(!image.open(inputFile, error)) {
+            cerr << "Failed to load binary image " << inputFile << ": " << error << endl;
+            return 1;
+        }
+        if(!concolic) {
+            // A cached image already holds the simplified final states; emit
+            // them from the mapping without rebuilding any Expr nodes.
+            ofstream ofs(outputFile, format == "bin" ? ios::binary : ios::out);
+            if(!ofs) {
+                cerr << "Failed to open output file " << outputFile << endl;
+                return 1;
+            }
+            if(format == "bin")
+                ofs.write(image.data(), image.bytes());
+            else
+                writeImageText(ofs, image);
+            if(rewriteStats)
+                printRewriteStats(cerr);
+            return ofs ? 0 : 1;
+        }
+        // Concolic runs re-execute the program, which needs the AST.
+        func = image.function();
+    } else {
+        ifstream ifs(inputFile);
+        if(!ifs) {
+            cerr << "Failed to open input file " << inputFile << endl;
+            return 1;
+        }
+        stringstream buffer;
+        buffer << ifs.rdbuf();
+        string programText = buffer.str();
+        vector<Token> tokens = tokenize(programText);
+        Parser parser(tokens);
+        func = parser.parseFunction();
+        if(!concolic)
+            finalStates = simplifyStates(symbolic_execution(func));
+    }
+
+    if(concolic) {
+        Bindings defaults;
+        vector<Bindings> rows;
+        string error;
+        if(!parseBindings(bindText, defaults, error) ||
+           (!inputsFile.empty() && !readInputRows(inputsFile, defaults, rows, rowLabels, error))) {
+            cerr << error << endl;
+            return 1;
+        }
+        if(inputsFile.empty())
+            rows.push_back(defaults);
+        for(size_t i = 0; i < rows.size(); i++) {
+            if(!checkBindings(func, rows[i], error)) {
+                cerr << (rowLabels.empty() ? string("--bind") : rowLabels[i]) << ": " << error << endl;
+                return 1;
+            }
+        }
+        rowStates = concolic_batch(func, rows, threads);
+        for(auto &states : rowStates)
+            states = simplifyStates(states);
+        if(inputsFile.empty())
+            finalStates = rowStates[0];
+    }
+    if(rewriteStats)
+        printRewriteStats(cerr);
+
+    if(format == "bin") {
+        if(!writeBinary(outputFile, func, finalStates)) {
+            cerr << "Failed to write output file " << outputFile << endl;
+            return 1;
+        }
+        return 0;
+    }
+    ofstream ofs(outputFile);
+    if(!ofs) {
+        cerr << "Failed to open output file " << outputFile << endl;
+        return 1;
+    }
+    if(inputsFile.empty()) {
+        writeText(ofs, finalStates);
+    } else {
+        for(size_t i = 0; i < rowStates.size(); i++) {
+            ofs << "# " << rowLabels[i] << "\n";
+            writeText(ofs, rowStates[i]);
+        }
+    }
     return 0;
 }
@@ -1,133 +1,303 @@
 #include "simplify.h"
 #include "ast.h"
-#include <stdexcept>
+#include <atomic>
+#include <cerrno>
+#include <climits>
 #include <cstdlib>
+#include <map>
 #include <memory>
+#include <vector>
 using namespace std;
 
-shared_ptr<Expr> simplify(shared_ptr<Expr> expr) {
-    if (!expr)
-        return expr;
+// Rewrite rules are matched against a node whose operands are already
+// simplified. Each rule names the roots it applies to, the shape each
+// operand must have, an optional guard and the replacement builder.
+
+// Root keys: binary operators use their OpCode, unary nodes follow them.
+enum { ROOT_NOT = OP_COUNT, ROOT_NEG, ROOT_COUNT };
+
+// Operand shape bits; a rule lists the bits an operand must carry (0 = any).
+enum {
+    S_CONST  = 1 << 0,
+    S_BOOL   = 1 << 1,
+    S_TRUE   = 1 << 2,
+    S_FALSE  = 1 << 3,
+    S_INT    = 1 << 4,
+    S_ADDSUB = 1 << 5,
+    S_CMP    = 1 << 6
+};
+
+#define ROOT(k) (1u << (k))
+
+// Bound on rewrites at a single node; every rule shrinks or pushes work
+// into operands, so this only guards against a badly written new rule.
+const int MAX_REWRITES_PER_NODE = 32;
+
+struct Match {
+    int root;
+    shared_ptr<Expr> left, right;   // right is null for unary roots
+};
+
+struct RewriteRule {
+    const char *name;
+    unsigned roots;
+    unsigned left, right;
+    bool (*guard)(const Match &m);
+    shared_ptr<Expr> (*build)(const Match &m);
+};
+
+static shared_ptr<Expr> normalize(shared_ptr<Expr> expr);
+
+static shared_ptr<Expr> mkBin(shared_ptr<Expr> l, int op, shared_ptr<Expr> r) {
+    return normalize(make_shared<BinOpExpr>(l, opName(op), r));
+}
+
+static shared_ptr<Expr> mkConst(const string &value) {
+    return make_shared<ConstExpr>(value);
+}
+
+static shared_ptr<Expr> mkBool(bool b) {
+    return mkConst(b ? "true" : "false");
+}
+
+bool parseInt(const string &s, long long &out) {
+    if (s.empty())
+        return false;
+    char *end;
+    errno = 0;
+    out = strtoll(s.c_str(), &end, 10);
+    return *end == '\0' && errno == 0 && out >= INT_MIN && out <= INT_MAX;
+}
+
+static long long intValue(const shared_ptr<Expr> &e) {
+    long long v = 0;
+    parseInt(static_pointer_cast<ConstExpr>(e)->value, v);
+    return v;
+}
+
+static bool boolValue(const shared_ptr<Expr> &e) {
+    return static_pointer_cast<ConstExpr>(e)->value == "true";
+}
+
+static unsigned shapeOf(const shared_ptr<Expr> &e) {
+    if (auto c = dynamic_pointer_cast<ConstExpr>(e)) {
+        long long v;
+        if (c->value == "true")
+            return S_CONST | S_BOOL | S_TRUE;
+        if (c->value == "false")
+            return S_CONST | S_BOOL | S_FALSE;
+        if (parseInt(c->value, v))
+            return S_CONST | S_INT;
+        return S_CONST;
+    }
+    if (auto bin = dynamic_pointer_cast<BinOpExpr>(e)) {
+        int op = opCode(bin->op);
+        if (op == OP_ADD || op == OP_SUB)
+            return S_ADDSUB;
+        if (op == OP_LT || op == OP_GT || op == OP_LE || op == OP_GE)
+            return S_CMP;
+    }
+    return 0;
+}
+
+// Guards
+
+static bool nonZeroDivisor(const Match &m) {
+    return m.root != OP_DIV || intValue(m.right) != 0;
+}
+
+// Identities only apply against a non-constant operand; mixed constants such
+// as "true & 1" are left untouched.
+static bool rightNotConst(const Match &m) {
+    return !dynamic_pointer_cast<ConstExpr>(m.right);
+}
+
+static bool leftNotConst(const Match &m) {
+    return !dynamic_pointer_cast<ConstExpr>(m.left);
+}
+
+// Builders
+
+static shared_ptr<Expr> foldInt(const Match &m) {
+    long long a = intValue(m.left), b = intValue(m.right), res = 0;
+    switch (m.root) {
+    case OP_ADD: res = a + b; break;
+    case OP_SUB: res = a - b; break;
+    case OP_MUL: res = a * b; break;
+    case OP_DIV: res = a / b; break;
+    case OP_LT: res = (a < b) ? 1 : 0; break;
+    case OP_GT: res = (a > b) ? 1 : 0; break;
+    case OP_LE: res = (a <= b) ? 1 : 0; break;
+    case OP_GE: res = (a >= b) ? 1 : 0; break;
+    }
+    return mkConst(to_string(static_cast<int>(res)));
+}
+
+static shared_ptr<Expr> foldLogic(const Match &m) {
+    bool a = boolValue(m.left), b = boolValue(m.right);
+    return mkBool(m.root == OP_AND ? (a && b) : (a || b));
+}
+
+static shared_ptr<Expr> takeLeft(const Match &m) { return m.left; }
+static shared_ptr<Expr> takeRight(const Match &m) { return m.right; }
+static shared_ptr<Expr> constTrue(const Match &) { return mkBool(true); }
+static shared_ptr<Expr> constFalse(const Match &) { return mkBool(false); }
+
+// (a +- b) * c  ->  (a * c) +- (b * c); not applied to /, which truncates
+static shared_ptr<Expr> distributeLeft(const Match &m) {
+    auto sum = static_pointer_cast<BinOpExpr>(m.left);
+    return mkBin(mkBin(sum->left, m.root, m.right), opCode(sum->op),
+                 mkBin(sum->right, m.root, m.right));
+}
+
+// c * (a +- b)  ->  (c * a) +- (c * b)
+static shared_ptr<Expr> distributeRight(const Match &m) {
+    auto sum = static_pointer_cast<BinOpExpr>(m.right);
+    return mkBin(mkBin(m.left, m.root, sum->left), opCode(sum->op),
+                 mkBin(m.left, m.root, sum->right));
+}
+
+static shared_ptr<Expr> negateComparison(const Match &m) {
+    auto cmp = static_pointer_cast<BinOpExpr>(m.left);
+    int flipped;
+    switch (opCode(cmp->op)) {
+    case OP_GT: flipped = OP_LE; break;
+    case OP_LT: flipped = OP_GE; break;
+    case OP_GE: flipped = OP_LT; break;
+    default: flipped = OP_GT; break;
+    }
+    return mkBin(cmp->left, flipped, cmp->right);
+}
+
+static shared_ptr<Expr> notBool(const Match &m) { return mkBool(!boolValue(m.left)); }
+
+static shared_ptr<Expr> negInt(const Match &m) {
+    return mkConst(to_string(-intValue(m.left)));
+}
+
+static const unsigned ARITH_ROOTS = ROOT(OP_ADD) | ROOT(OP_SUB) | ROOT(OP_MUL) | ROOT(OP_DIV) |
+                                    ROOT(OP_LT) | ROOT(OP_GT) | ROOT(OP_LE) | ROOT(OP_GE);
+static const unsigned LOGIC_ROOTS = ROOT(OP_AND) | ROOT(OP_OR);
+
+static const RewriteRule RULES[] = {
+    {"fold-int",          ARITH_ROOTS,               S_INT,    S_INT,    nonZeroDivisor, foldInt},
+    {"fold-logic",        LOGIC_ROOTS,               S_BOOL,   S_BOOL,   nullptr, foldLogic},
+    {"or-false-left",     ROOT(OP_OR),               S_FALSE,  0,        rightNotConst, takeRight},
+    {"or-true-left",      ROOT(OP_OR),               S_TRUE,   0,        rightNotConst, constTrue},
+    {"and-false-left",    ROOT(OP_AND),              S_FALSE,  0,        rightNotConst, constFalse},
+    {"and-true-left",     ROOT(OP_AND),              S_TRUE,   0,        rightNotConst, takeRight},
+    {"or-false-right",    ROOT(OP_OR),               0,        S_FALSE,  leftNotConst, takeLeft},
+    {"or-true-right",     ROOT(OP_OR),               0,        S_TRUE,   leftNotConst, constTrue},
+    {"and-false-right",   ROOT(OP_AND),              0,        S_FALSE,  leftNotConst, constFalse},
+    {"and-true-right",    ROOT(OP_AND),              0,        S_TRUE,   leftNotConst, takeLeft},
+    {"distribute-left",   ROOT(OP_MUL),              S_ADDSUB, 0,        nullptr, distributeLeft},
+    {"distribute-right",  ROOT(OP_MUL),              0,        S_ADDSUB, nullptr, distributeRight},
+    {"not-comparison",    ROOT(ROOT_NOT),            S_CMP,    0,        nullptr, negateComparison},
+    {"not-bool",          ROOT(ROOT_NOT),            S_BOOL,   0,        nullptr, notBool},
+    {"neg-int",           ROOT(ROOT_NEG),            S_INT,    0,        nullptr, negInt},
+};
+static const size_t RULE_COUNT = sizeof(RULES) / sizeof(RULES[0]);
+
+static atomic<unsigned long> ruleHits[RULE_COUNT];
+
+// Rules per root key, in table order, so a node only tries rules for its own operator.
+static vector<vector<size_t>> buildIndex() {
+    vector<vector<size_t>> index(ROOT_COUNT);
+    for (size_t i = 0; i < RULE_COUNT; i++)
+        for (int k = 0; k < ROOT_COUNT; k++)
+            if (RULES[i].roots & ROOT(k))
+                index[k].push_back(i);
+    return index;
+}
+
+static const vector<vector<size_t>> RULE_INDEX = buildIndex();
+
+static bool matchRoot(const shared_ptr<Expr> &expr, Match &m) {
     if (auto bin = dynamic_pointer_cast<BinOpExpr>(expr)) {
-        auto left = simplify(bin->left);
-        auto right = simplify(bin->right);
-        auto leftConst = dynamic_pointer_cast<ConstExpr>(left);
-        auto rightConst = dynamic_pointer_cast<ConstExpr>(right);
-        
-        if (leftConst && rightConst) {
-            if (bin->op == "&" || bin->op == "|") {
-                bool a, b;
-                if (leftConst->value == "true")
-                    a = true;
-                else if (leftConst->value == "false")
-                    a = false;
-                else return make_shared<BinOpExpr>(left, bin->op, right);
-                
-                if (rightConst->value == "true")
-                    b = true;
-                else if (rightConst->value == "false")
-                    b = false;
-                else return make_shared<BinOpExpr>(left, bin->op, right);
-                
-                bool res = (bin->op == "&") ? (a && b) : (a || b);
-                return make_shared<ConstExpr>(res ? "true" : "false");
-            }
-            try {
-                int a = stoi(leftConst->value);
-                int b = stoi(rightConst->value);
-                int res;
-                if (bin->op == "+") res = a + b;
-                else if (bin->op == "-") res = a - b;
-                else if (bin->op == "*") res = a * b;
-                else if (bin->op == "/") res = a / b;
-                else if (bin->op == "<") res = (a < b) ? 1 : 0;
-                else if (bin->op == ">") res = (a > b) ? 1 : 0;
-                else if (bin->op == "<=") res = (a <= b) ? 1 : 0;
-                else if (bin->op == ">=") res = (a >= b) ? 1 : 0;
-                else return make_shared<BinOpExpr>(left, bin->op, right);
-                return make_shared<ConstExpr>(to_string(res));
-            } catch (const std::invalid_argument&) {
-                return make_shared<BinOpExpr>(left, bin->op, right);
-            }
-        } else {
-            if (bin->op == "|" || bin->op == "&") {
-                if (leftConst) {
-                    if (bin->op == "|" && leftConst->value == "false")
-                        return right;
-                    if (bin->op == "|" && leftConst->value == "true")
-                        return make_shared<ConstExpr>("true");
-                    if (bin->op == "&" && leftConst->value == "false")
-                        return make_shared<ConstExpr>("false");
-                    if (bin->op == "&" && leftConst->value == "true")
-                        return right;
-                }
-                if (rightConst) {
-                    if (bin->op == "|" && rightConst->value == "false")
-                        return left;
-                    if (bin->op == "|" && rightConst->value == "true")
-                        return make_shared<ConstExpr>("true");
-                    if (bin->op == "&" && rightConst->value == "false")
-                        return make_shared<ConstExpr>("false");
-                    if (bin->op == "&" && rightConst->value == "true")
-                        return left;
-                }
-            }
-            if (bin->op == "*" || bin->op == "/") {
-                if (auto leftBin = dynamic_pointer_cast<BinOpExpr>(left)) {
-                    if (leftBin->op == "+" || leftBin->op == "-") {
-                        auto distributed = make_shared<BinOpExpr>(
-                            make_shared<BinOpExpr>(leftBin->left, bin->op, right),
-                            leftBin->op,
-                            make_shared<BinOpExpr>(leftBin->right, bin->op, right)
-                        );
-                        return simplify(distributed);
-                    }
-                }
-                if (auto rightBin = dynamic_pointer_cast<BinOpExpr>(right)) {
-                    if (rightBin->op == "+" || rightBin->op == "-") {
-                        auto distributed = make_shared<BinOpExpr>(
-                            make_shared<BinOpExpr>(left, bin->op, rightBin->left),
-                            rightBin->op,
-                            make_shared<BinOpExpr>(left, bin->op, rightBin->right)
-                        );
-                        return simplify(distributed);
-                    }
-                }
-            }
-            return make_shared<BinOpExpr>(left, bin->op, right);
-        }
-    } else if (auto notExpr = dynamic_pointer_cast<NotExpr>(expr)) {
-        auto inner = simplify(notExpr->expr);
-        if (auto bin = dynamic_pointer_cast<BinOpExpr>(inner)) {
-            if (bin->op == ">")
-                return simplify(make_shared<BinOpExpr>(bin->left, "<=", bin->right));
-            else if (bin->op == "<")
-                return simplify(make_shared<BinOpExpr>(bin->left, ">=", bin->right));
-            else if (bin->op == ">=")
-                return simplify(make_shared<BinOpExpr>(bin->left, "<", bin->right));
-            else if (bin->op == "<=")
-                return simplify(make_shared<BinOpExpr>(bin->left, ">", bin->right));
-        }
-        auto innerConst = dynamic_pointer_cast<ConstExpr>(inner);
-        if (innerConst) {
-            if (innerConst->value == "true")
-                return make_shared<ConstExpr>("false");
-            else if (innerConst->value == "false")
-                return make_shared<ConstExpr>("true");
-        }
-        return make_shared<NotExpr>(inner);
-    } else if (auto negExpr = dynamic_pointer_cast<NegExpr>(expr)) {
-        auto inner = simplify(negExpr->expr);
-        auto innerConst = dynamic_pointer_cast<ConstExpr>(inner);
-        if (innerConst) {
-            try {
-                int a = stoi(innerConst->value);
-                return make_shared<ConstExpr>(to_string(-a));
-            } catch (const std::invalid_argument&) {
-                return make_shared<NegExpr>(inner);
-            }
+        m.root = opCode(bin->op);
+        m.left = bin->left;
+        m.right = bin->right;
+        return m.root >= 0;
+    }
+    m.right = nullptr;
+    if (auto notE = dynamic_pointer_cast<NotExpr>(expr)) {
+        m.root = ROOT_NOT;
+        m.left = notE->expr;
+        return true;
+    }
+    if (auto negE = dynamic_pointer_cast<NegExpr>(expr)) {
+        m.root = ROOT_NEG;
+        m.left = negE->expr;
+        return true;
+    }
+    return false;
+}
+
+// Apply root rules to a node whose operands are already simplified until none fires.
+static shared_ptr<Expr> normalize(shared_ptr<Expr> expr) {
+    for (int step = 0; step < MAX_REWRITES_PER_NODE; step++) {
+        Match m;
+        if (!matchRoot(expr, m))
+            return expr;
+        unsigned leftShape = shapeOf(m.left);
+        unsigned rightShape = m.right ? shapeOf(m.right) : 0;
+        const RewriteRule *fired = nullptr;
+        for (size_t id : RULE_INDEX[m.root]) {
+            const RewriteRule &r = RULES[id];
+            if ((leftShape & r.left) != r.left || (rightShape & r.right) != r.right)
+                continue;
+            if (r.guard && !r.guard(m))
+                continue;
+            ruleHits[id].fetch_add(1, memory_order_relaxed);
+            fired = &r;
+            break;
         }
-        return make_shared<NegExpr>(inner);
+        if (!fired)
+            return expr;
+        expr = fired->build(m);
     }
     return expr;
 }
+
+// Bottom-up pass; shared subtrees are simplified once per call.
+static shared_ptr<Expr> simplifyNode(const shared_ptr<Expr> &expr, map<const Expr *, shared_ptr<Expr>> &memo) {
+    auto it = memo.find(expr.get());
+    if (it != memo.end())
+        return it->second;
+    shared_ptr<Expr> result = expr;
+    if (auto bin = dynamic_pointer_cast<BinOpExpr>(expr)) {
+        auto left = simplifyNode(bin->left, memo);
+        auto right = simplifyNode(bin->right, memo);
+        if (left != bin->left || right != bin->right)
+            result = make_shared<BinOpExpr>(left, bin->op, right);
+    } else if (auto notE = dynamic_pointer_cast<NotExpr>(expr)) {
+        auto inner = simplifyNode(notE->expr, memo);
+        if (inner != notE->expr)
+            result = make_shared<NotExpr>(inner);
+    } else if (auto negE = dynamic_pointer_cast<NegExpr>(expr)) {
+        auto inner = simplifyNode(negE->expr, memo);
+        if (inner != negE->expr)
+            result = make_shared<NegExpr>(inner);
+    }
+    result = normalize(result);
+    memo[expr.get()] = result;
+    return result;
+}
+
+shared_ptr<Expr> simplify(shared_ptr<Expr> expr) {
+    if (!expr)
+        return expr;
+    map<const Expr *, shared_ptr<Expr>> memo;
+    return simplifyNode(expr, memo);
+}
+
+shared_ptr<Expr> simplifyRoot(shared_ptr<Expr> expr) {
+    if (!expr)
+        return expr;
+    return normalize(expr);
+}
+
+void printRewriteStats(ostream &os) {
+    for (size_t i = 0; i < RULE_COUNT; i++)
+        os << RULES[i].name << "\t" << ruleHits[i].load(memory_order_relaxed) << "\n";
+}